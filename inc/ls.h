@@ -6,11 +6,14 @@
 #define GREEN "\x1B[32m"
 #define RESET "\x1B[0m"
 
+#define PARALLEL_SORT_THRESHOLD 65536
+
 #include "libft.h"
 
 #include <sys/xattr.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/vfs.h>
 
 #include <grp.h>
 #include <pwd.h>
@@ -20,8 +23,11 @@
 #include <time.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <errno.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
 
 typedef struct {
 	const char	**items;
@@ -33,6 +39,7 @@ typedef struct {
 	char		*link;
 	char		*name;
 	struct stat	stat;
+	bool		orphan;   // link target missing, only checked when colored
 }   FileInfo;
 
 typedef struct {
@@ -41,9 +48,37 @@ typedef struct {
     size_t      capacity;
 }   FilesInfo;
 
+typedef struct {
+	size_t	blocks;   // 1K blocks, as in the -l total
+	size_t	size;     // apparent size in bytes
+	size_t	entries;
+}	Usage;
+
+typedef struct {
+	dev_t	dev;
+	ino_t	ino;
+	bool	used;
+}	InodeKey;
+
+typedef struct {
+	InodeKey	*items;
+	size_t		count;
+	size_t		capacity; // always a power of two
+}	InodeSet;
+
+typedef enum {
+	IO_LOCAL,    // Disk filesystems: one fd-relative stat per entry
+	IO_MEMORY,   // tmpfs, procfs: same, there is no latency to hide
+	IO_NETWORK,  // NFS, CIFS: names read first, then stat-ed in parallel
+	IO_FUSE,     // FUSE: parallel stat, optional probes like listxattr skipped
+}	IoProfile;
+
 typedef struct {
 	char		*path;
 	FilesInfo	files;
+	Usage		usage;    // rolled up over the subtree with --disk-usage
+	IoProfile	profile;
+	int			error;    // errno when the directory could not be opened
 }   DirectoryInfo;
 
 typedef struct {
@@ -80,6 +115,8 @@ typedef enum {
 	REVERSE	        = 1 << 3,  // -r flag
 	DIRECTORY	    = 1 << 4,  // -d flag
 	ACCESS_TIME     = 1 << 5,  // -u flag
+	DISK_USAGE      = 1 << 6,  // --disk-usage flag
+	IO_DEBUG        = 1 << 7,  // --io-debug flag
 }   Options;
 
 typedef enum {
@@ -96,18 +133,144 @@ typedef enum {
 	SHOW_ALMOST_ALL,  // -A flag: show all except . and ..
 }   ShowType;
 
-bool    parse_args_options(int ac, char **av);
+typedef enum {
+	COLOR_NORMAL,                 // no
+	COLOR_FILE,                   // fi
+	COLOR_DIR,                    // di
+	COLOR_LINK,                   // ln
+	COLOR_FIFO,                   // pi
+	COLOR_SOCKET,                 // so
+	COLOR_BLOCK,                  // bd
+	COLOR_CHAR,                   // cd
+	COLOR_ORPHAN,                 // or
+	COLOR_MISSING,                // mi
+	COLOR_SETUID,                 // su
+	COLOR_SETGID,                 // sg
+	COLOR_STICKY,                 // st
+	COLOR_STICKY_OTHER_WRITABLE,  // tw
+	COLOR_OTHER_WRITABLE,         // ow
+	COLOR_EXEC,                   // ex
+	COLOR_MULTI_HARDLINK,         // mh
+	COLOR_TYPE_COUNT,
+}	ColorType;
+
+typedef struct {
+	char	*suffix;    // NULL marks a free slot
+	size_t	length;
+	char	*sequence;  // full escape sequence
+}	ColorExtension;
+
+typedef struct {
+	ColorExtension	*items;
+	size_t			count;
+	size_t			capacity;
+}	ColorExtensions;
+
+typedef struct {
+	size_t	*items;
+	size_t	count;
+	size_t	capacity;
+}	SuffixLengths;
+
+// LS_COLORS parsed once: escape sequences per type, and suffixes hashed
+// into an open addressing table probed once per distinct suffix length
+typedef struct {
+	char			*types[COLOR_TYPE_COUNT];
+	ColorExtension	*extensions;
+	size_t			capacity;  // always a power of two
+	SuffixLengths	lengths;   // longest first
+}	ColorTable;
+
+typedef struct {
+	Options				options;
+	SortType			sort_type;
+	ShowType			show_type;
+	size_t				head;       // --head=N, 0 lists every entry
+	const ColorTable	*colors;    // NULL keeps the built-in colors
+}	Config;
+
+// Allocator used for the name and link strings of yielded FileInfo records
+typedef struct {
+	void	*(*alloc)(size_t size, void *context);
+	void	(*free)(void *ptr, void *context);
+	void	*context;
+}	Allocator;
+
+typedef struct {
+	char		*name;
+	struct stat	stat;
+	bool		ok;
+}	BatchEntry;
+
+typedef struct {
+	BatchEntry	*items;
+	size_t		count;
+	size_t		capacity;
+}	BatchEntries;
+
+typedef struct {
+	DIR				*dir;
+	const char		*path;
+	const Config	*config;
+	Allocator		allocator;
+	IoProfile		profile;
+	const char		*fs_name;
+	BatchEntries	batch;       // entries stat-ed ahead by batching profiles
+	size_t			batch_next;
+	bool			batch_done;  // readdir reached the end of the directory
+}	DirectoryIterator;
+
+// Return false to stop the walk, file is only borrowed for the call
+typedef bool (*WalkCallback)(const char *path, const FileInfo *file, void *data);
+
+// Called with errno for each directory that cannot be opened, return false to stop
+typedef bool (*WalkErrorCallback)(const char *path, int error, void *data);
+
+bool    parse_args_options(int ac, char **av, Config *config);
 bool    parse_args_files(int ac, char **av, Files *names);
 
-int     compare_name(const void *a, const void *b);
-int     compare_file_name(const void *a, const void *b);
-int     compare_file_size(const void *a, const void *b);
-int     compare_file_mtime(const void *a, const void *b);
-int     compare_file_atime(const void *a, const void *b);
+bool	is_file_hidden(const char *name);
+bool	is_file_special(const char *name);
+char	*build_path(const char *dir_path, const char *filename);
+void	file_info_free(FileInfo *file, const Allocator *allocator);
+
+const char	*io_profile_name(IoProfile profile);
+bool	io_profile_probes_xattr(IoProfile profile);
+
+bool	iterator_open(DirectoryIterator *it, const char *path, const Config *config, const Allocator *allocator);
+int		iterator_next(DirectoryIterator *it, FileInfo *file);
+void	iterator_close(DirectoryIterator *it);
+bool	walk_directory(const char *path, const Config *config, const Allocator *allocator, WalkCallback callback, WalkErrorCallback on_error, void *data);
+
+int		compare_files(const FileInfo *a, const FileInfo *b, SortType sort_type);
+void	sort_files(FileInfo *items, size_t count, SortType sort_type, bool reverse);
+bool	parallel_sort_files(FileInfo *items, size_t count, SortType sort_type, bool reverse);
+
+bool	inode_set_insert(InodeSet *set, const struct stat *st, bool *inserted);
+void	inode_set_free(InodeSet *set);
+bool	usage_add_file(Usage *usage, const FileInfo *file, InodeSet *seen);
+void	usage_merge(Usage *parent, const Usage *child);
+
+bool	color_table_init(ColorTable *colors, const char *ls_colors);
+void	color_table_free(ColorTable *colors);
+const char	*color_lookup(const ColorTable *colors, const char *name, const struct stat *st, bool orphan);
+
+void	print_formatted(DirectoryInfo *directory, const Config *config);
+void	print_list_formatted(DirectoryInfo *directory, const Config *config);
+void	print_usage_summary(const char *path, const Usage *usage);
+
+typedef void (*ParallelTask)(size_t index, void *data);
 
-void	print_formatted(DirectoryInfo *directory);
-void	print_list_formatted(DirectoryInfo *directory);
+void	parallel_for(size_t count, size_t max_threads, ParallelTask task, void *data);
 
-void	process_directory(char *path);
+bool	read_directory(const char *path, DirectoryInfo *directory, const Config *config, InodeSet *seen);
+void	print_directory_error(const char *path, int error);
+void	sort_directory(DirectoryInfo *directory, const Config *config);
+void	print_directory(DirectoryInfo *directory, const Config *config, bool show_header);
+void	free_directory(DirectoryInfo *directory);
+void	list_directory(DirectoryInfo *directory, const Config *config, InodeSet *seen, bool show_header);
+void	process_directory(const char *path, const Config *config);
+void	walk_pipeline(DirectoryInfo *root, const Config *config, InodeSet *seen);
+bool	process_operands(const char **names, size_t count, const Config *config);
 
 #endif
@@ -1,32 +1,60 @@
 #include "ls.h"
 
-extern Options options;
-extern SortType sort_type;
-extern ShowType show_type;
+static bool parse_head(const char *arg, Config *config) {
+	size_t value = 0;
 
-bool	parse_args_options(int ac, char **av) {
+	if (*arg == '\0') {
+		return (false);
+	}
+	for (const char *c = arg; *c; c++) {
+		if (!ft_isdigit(*c) || value > (SIZE_MAX - (*c - '0')) / 10) {
+			return (false);
+		}
+		value = value * 10 + (*c - '0');
+	}
+	// 0 is how config->head says "no limit", so it cannot be asked for
+	if (value == 0) {
+		return (false);
+	}
+	config->head = value;
+	return (true);
+}
+
+bool	parse_args_options(int ac, char **av, Config *config) {
 	bool process_flag = true;
 	
 	for (int i = 1; i < ac; i++) {
 		if (process_flag == true && av[i][0] == '-' && av[i][1] != '\0') {
 			if (ft_strcmp(av[i], "--") == 0) {
 				process_flag = false;
+			} else if (ft_strncmp(av[i], "--head=", 7) == 0) {
+				if (parse_head(av[i] + 7, config) == false) {
+					fprintf(stderr, "ft_ls: invalid --head argument '%s'\n", av[i] + 7);
+					return (false);
+				}
+			} else if (ft_strcmp(av[i], "--disk-usage") == 0) {
+				config->options |= DISK_USAGE;
+			} else if (ft_strcmp(av[i], "--io-debug") == 0) {
+				config->options |= IO_DEBUG;
+			} else if (av[i][1] == '-') {
+				fprintf(stderr, "ft_ls: unrecognized option '%s'\n", av[i]);
+				return (false);
 			} else {
 				char *opt = av[i];
 				while (*(++opt)) {
 					switch (*opt) {
-						case 'l': options |= LIST; break;
-						case 'g': options |= LIST_GROUP_ONLY; break;
-						case 'R': options |= RECURSE; break;
-						case 'r': options |= REVERSE; break;
-						case 'd': options |= DIRECTORY; break;
-						case 'u': options |= ACCESS_TIME; break;
-						case 'a': show_type = SHOW_ALL; break;
-						case 'f': show_type = SHOW_ALL; sort_type = SORT_NONE; break;
-						case 'A': show_type = SHOW_ALMOST_ALL; break;
-						case 't': sort_type = SORT_MTIME; break;
-						case 'S': sort_type = SORT_SIZE; break;
-						case 'U': sort_type = SORT_NONE; break;
+						case 'l': config->options |= LIST; break;
+						case 'g': config->options |= LIST_GROUP_ONLY; break;
+						case 'R': config->options |= RECURSE; break;
+						case 'r': config->options |= REVERSE; break;
+						case 'd': config->options |= DIRECTORY; break;
+						case 'u': config->options |= ACCESS_TIME; break;
+						case 'a': config->show_type = SHOW_ALL; break;
+						case 'f': config->show_type = SHOW_ALL; config->sort_type = SORT_NONE; break;
+						case 'A': config->show_type = SHOW_ALMOST_ALL; break;
+						case 't': config->sort_type = SORT_MTIME; break;
+						case 'S': config->sort_type = SORT_SIZE; break;
+						case 'U': config->sort_type = SORT_NONE; break;
 						default:
 							fprintf(stderr, "ft_ls: invalid option -- '%c'\n", *opt);
 							return (false);
@@ -36,14 +64,20 @@ bool	parse_args_options(int ac, char **av) {
 		}
 	}
 	
-	if (options & ACCESS_TIME) {
-		if (options & LIST) {
-			if (sort_type == SORT_MTIME) {
-				sort_type = SORT_ATIME;
+	// --head drops entries and skips their subdirectories, totals would be partial
+	if (config->head > 0 && (config->options & DISK_USAGE)) {
+		fprintf(stderr, "ft_ls: --head cannot be combined with --disk-usage\n");
+		return (false);
+	}
+
+	if (config->options & ACCESS_TIME) {
+		if (config->options & LIST) {
+			if (config->sort_type == SORT_MTIME) {
+				config->sort_type = SORT_ATIME;
 			}
 		} else {
-			if (sort_type == SORT_NAME) {
-				sort_type = SORT_ATIME;
+			if (config->sort_type == SORT_NAME) {
+				config->sort_type = SORT_ATIME;
 			}
 		}
 	}
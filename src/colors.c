@@ -0,0 +1,284 @@
+#include "ls.h"
+
+typedef struct {
+	const char	*key;
+	ColorType	type;
+}	ColorKey;
+
+static const ColorKey color_keys[] = {
+	{"no", COLOR_NORMAL},
+	{"fi", COLOR_FILE},
+	{"di", COLOR_DIR},
+	{"ln", COLOR_LINK},
+	{"pi", COLOR_FIFO},
+	{"so", COLOR_SOCKET},
+	{"bd", COLOR_BLOCK},
+	{"cd", COLOR_CHAR},
+	{"or", COLOR_ORPHAN},
+	{"mi", COLOR_MISSING},
+	{"su", COLOR_SETUID},
+	{"sg", COLOR_SETGID},
+	{"st", COLOR_STICKY},
+	{"tw", COLOR_STICKY_OTHER_WRITABLE},
+	{"ow", COLOR_OTHER_WRITABLE},
+	{"ex", COLOR_EXEC},
+	{"mh", COLOR_MULTI_HARDLINK},
+};
+
+static uint32_t suffix_hash(const char *suffix, size_t length) {
+	uint32_t hash = 2166136261u ^ (uint32_t)length;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)ft_tolower((unsigned char)suffix[i]);
+		hash *= 16777619u;
+	}
+	return (hash);
+}
+
+static bool suffix_equal(const char *a, const char *b, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		if (ft_tolower((unsigned char)a[i]) != ft_tolower((unsigned char)b[i])) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+// Wraps an LS_COLORS value such as 01;34 into its full escape sequence
+static char *make_sequence(const char *code, size_t length) {
+	char *sequence = malloc(length + 4);
+	if (!sequence) {
+		return (NULL);
+	}
+	ft_memcpy(sequence, "\x1B[", 2);
+	ft_memcpy(sequence + 2, code, length);
+	sequence[length + 2] = 'm';
+	sequence[length + 3] = '\0';
+	return (sequence);
+}
+
+static bool set_type(ColorTable *colors, ColorType type, const char *sequence) {
+	char *copy = ft_strdup(sequence);
+	if (!copy) {
+		return (false);
+	}
+	free(colors->types[type]);
+	colors->types[type] = copy;
+	return (true);
+}
+
+static ColorExtension *find_slot(ColorExtension *slots, size_t capacity, const char *suffix, size_t length) {
+	size_t index = suffix_hash(suffix, length) & (capacity - 1);
+	while (slots[index].suffix) {
+		if (slots[index].length == length && suffix_equal(slots[index].suffix, suffix, length)) {
+			break;
+		}
+		index = (index + 1) & (capacity - 1);
+	}
+	return (&slots[index]);
+}
+
+static bool add_length(ColorTable *colors, size_t length) {
+	for (size_t i = 0; i < colors->lengths.count; i++) {
+		if (colors->lengths.items[i] == length) {
+			return (true);
+		}
+	}
+	if (!ft_da_append(&colors->lengths, length)) {
+		return (false);
+	}
+
+	// Longest first, so *.tar.gz wins over *.gz
+	for (size_t i = colors->lengths.count - 1; i > 0 && colors->lengths.items[i - 1] < length; i--) {
+		colors->lengths.items[i] = colors->lengths.items[i - 1];
+		colors->lengths.items[i - 1] = length;
+	}
+	return (true);
+}
+
+static bool build_extension_table(ColorTable *colors, ColorExtensions *parsed) {
+	size_t capacity = 16;
+	while (capacity < parsed->count * 2) {
+		capacity *= 2;
+	}
+
+	colors->extensions = calloc(capacity, sizeof(ColorExtension));
+	if (!colors->extensions) {
+		return (false);
+	}
+	colors->capacity = capacity;
+
+	// Later entries override earlier ones for the same suffix
+	ft_da_foreach(parsed, entry, ColorExtension) {
+		ColorExtension *slot = find_slot(colors->extensions, capacity, entry->suffix, entry->length);
+		if (slot->suffix) {
+			free(slot->suffix);
+			free(slot->sequence);
+		}
+		*slot = *entry;
+		*entry = (ColorExtension){0};
+		if (!add_length(colors, slot->length)) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+static bool parse_entry(ColorTable *colors, ColorExtensions *parsed, const char *entry, size_t length) {
+	const char *equal = entry;
+	while (equal < entry + length && *equal != '=') {
+		equal++;
+	}
+	if (equal == entry + length) {
+		return (true);
+	}
+
+	size_t key_length = equal - entry;
+	const char *value = equal + 1;
+	size_t value_length = length - key_length - 1;
+
+	if (key_length > 1 && entry[0] == '*') {
+		ColorExtension extension = {0};
+		extension.length = key_length - 1;
+		extension.suffix = ft_strndup(entry + 1, extension.length);
+		extension.sequence = make_sequence(value, value_length);
+		if (!extension.suffix || !extension.sequence || !ft_da_append(parsed, extension)) {
+			free(extension.suffix);
+			free(extension.sequence);
+			return (false);
+		}
+		return (true);
+	}
+
+	for (size_t i = 0; i < sizeof(color_keys) / sizeof(color_keys[0]); i++) {
+		if (key_length == 2 && ft_strncmp(entry, color_keys[i].key, 2) == 0) {
+			// ln=target would need the target of every link, keep the default
+			if (value_length == 6 && ft_strncmp(value, "target", 6) == 0) {
+				return (true);
+			}
+
+			char *sequence = make_sequence(value, value_length);
+			if (!sequence) {
+				return (false);
+			}
+			free(colors->types[color_keys[i].type]);
+			colors->types[color_keys[i].type] = sequence;
+			return (true);
+		}
+	}
+
+	// Unknown keys such as lc, rc or rs are ignored
+	return (true);
+}
+
+bool color_table_init(ColorTable *colors, const char *ls_colors) {
+	*colors = (ColorTable){0};
+
+	// Same defaults as without LS_COLORS, overridden by the entries below
+	if (!set_type(colors, COLOR_DIR, BLUE) || !set_type(colors, COLOR_LINK, CYAN)
+		|| !set_type(colors, COLOR_FIFO, CYAN) || !set_type(colors, COLOR_EXEC, GREEN)) {
+		color_table_free(colors);
+		return (false);
+	}
+
+	ColorExtensions parsed = {0};
+	bool success = true;
+	const char *entry = ls_colors;
+	while (success && entry && *entry) {
+		const char *end = entry;
+		while (*end && *end != ':') {
+			end++;
+		}
+		success = parse_entry(colors, &parsed, entry, end - entry);
+		entry = (*end == ':') ? end + 1 : end;
+	}
+
+	if (success) {
+		success = build_extension_table(colors, &parsed);
+	}
+
+	ft_da_foreach(&parsed, extension, ColorExtension) {
+		free(extension->suffix);
+		free(extension->sequence);
+	}
+	ft_da_free(parsed);
+
+	if (!success) {
+		color_table_free(colors);
+	}
+	return (success);
+}
+
+void color_table_free(ColorTable *colors) {
+	for (size_t i = 0; i < COLOR_TYPE_COUNT; i++) {
+		free(colors->types[i]);
+	}
+	for (size_t i = 0; i < colors->capacity; i++) {
+		free(colors->extensions[i].suffix);
+		free(colors->extensions[i].sequence);
+	}
+	free(colors->extensions);
+	ft_da_free(colors->lengths);
+	*colors = (ColorTable){0};
+}
+
+static const char *lookup_extension(const ColorTable *colors, const char *name) {
+	if (colors->capacity == 0) {
+		return (NULL);
+	}
+
+	size_t name_length = ft_strlen(name);
+	for (size_t i = 0; i < colors->lengths.count; i++) {
+		size_t length = colors->lengths.items[i];
+		if (length > name_length) continue;
+
+		const char *suffix = name + name_length - length;
+		ColorExtension *slot = find_slot(colors->extensions, colors->capacity, suffix, length);
+		if (slot->suffix) {
+			return (slot->sequence);
+		}
+	}
+	return (NULL);
+}
+
+static ColorType classify(const ColorTable *colors, const struct stat *st, bool orphan) {
+	mode_t mode = st->st_mode;
+
+	if (S_ISDIR(mode)) {
+		if ((mode & S_ISVTX) && (mode & S_IWOTH) && colors->types[COLOR_STICKY_OTHER_WRITABLE]) {
+			return (COLOR_STICKY_OTHER_WRITABLE);
+		}
+		if ((mode & S_IWOTH) && colors->types[COLOR_OTHER_WRITABLE]) return (COLOR_OTHER_WRITABLE);
+		if ((mode & S_ISVTX) && colors->types[COLOR_STICKY]) return (COLOR_STICKY);
+		return (COLOR_DIR);
+	}
+	if (S_ISLNK(mode)) {
+		return ((orphan && colors->types[COLOR_ORPHAN]) ? COLOR_ORPHAN : COLOR_LINK);
+	}
+	if (S_ISFIFO(mode)) return (COLOR_FIFO);
+	if (S_ISSOCK(mode)) return (COLOR_SOCKET);
+	if (S_ISBLK(mode))  return (COLOR_BLOCK);
+	if (S_ISCHR(mode))  return (COLOR_CHAR);
+
+	if ((mode & S_ISUID) && colors->types[COLOR_SETUID]) return (COLOR_SETUID);
+	if ((mode & S_ISGID) && colors->types[COLOR_SETGID]) return (COLOR_SETGID);
+	if ((mode & (S_IXUSR | S_IXGRP | S_IXOTH)) && colors->types[COLOR_EXEC]) return (COLOR_EXEC);
+	if (st->st_nlink > 1 && colors->types[COLOR_MULTI_HARDLINK]) return (COLOR_MULTI_HARDLINK);
+	return (COLOR_FILE);
+}
+
+const char *color_lookup(const ColorTable *colors, const char *name, const struct stat *st, bool orphan) {
+	ColorType type = classify(colors, st, orphan);
+
+	// Extensions only apply to regular files without a more specific color
+	if (type == COLOR_FILE) {
+		const char *sequence = lookup_extension(colors, name);
+		if (sequence) {
+			return (sequence);
+		}
+	}
+
+	if (colors->types[type]) {
+		return (colors->types[type]);
+	}
+	return (colors->types[COLOR_NORMAL]);
+}
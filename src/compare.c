@@ -1,106 +1,137 @@
 #include "ls.h"
 
-int compare_file_name(const void *a, const void *b) {
-	if (!a || !b) return (0);
+#define INSERTION_SORT_THRESHOLD 16
 
-	const FileInfo *file_a = *(const FileInfo **)a;
-	const FileInfo *file_b = *(const FileInfo **)b;
+// Same order as ft_strtolower on both names then ft_strcmp, without the copies
+static inline int file_compare_name(const FileInfo *a, const FileInfo *b) {
+	const unsigned char *s1 = (const unsigned char *)a->name;
+	const unsigned char *s2 = (const unsigned char *)b->name;
 
-	if (!file_a || !file_b) return (0);
-	if (!file_a->name || !file_b->name) return (0);
-
-	char *t1 = ft_strdup(file_a->name);
-	char *t2 = ft_strdup(file_b->name);
-
-	if (!t1 || !t2) {
-		if (t1) free(t1);
-		if (t2) free(t2);
-		return (0);
+	while (*s1 && ft_tolower(*s1) == ft_tolower(*s2)) {
+		s1++;
+		s2++;
 	}
 
-	ft_strtolower(t1);
-	ft_strtolower(t2);
-
-	int result = ft_strcmp(t1, t2);
-
-	free(t1);
-	free(t2);
+	int result = ft_tolower(*s1) - ft_tolower(*s2);
 
+	// Names differing only by case still get a fixed order
+	if (result == 0) {
+		result = ft_strcmp(a->name, b->name);
+	}
 	return (result);
 }
 
-int compare_file_mtime(const void *a, const void *b) {
-	if (!a || !b) return (0);
-
-	const FileInfo *file_a = *(const FileInfo **)a;
-	const FileInfo *file_b = *(const FileInfo **)b;
-	
-	if (!file_a || !file_b) return (0);
-		
-	time_t time_a = file_a->stat.st_mtime;
-	time_t time_b = file_b->stat.st_mtime;
-	
-	if (time_a < time_b) return (1);
-	if (time_a > time_b) return (-1);
-	return (0);
+static inline int file_compare_mtime(const FileInfo *a, const FileInfo *b) {
+	if (a->stat.st_mtime < b->stat.st_mtime) return (1);
+	if (a->stat.st_mtime > b->stat.st_mtime) return (-1);
+	return (file_compare_name(a, b));
 }
 
-int compare_file_atime(const void *a, const void *b) {
-	if (!a || !b) return (0);
-
-	const FileInfo *file_a = *(const FileInfo **)a;
-	const FileInfo *file_b = *(const FileInfo **)b;
-	
-	if (!file_a || !file_b) return (0);
-
-	time_t time_a = file_a->stat.st_atime;
-	time_t time_b = file_b->stat.st_atime;
-	
-	if (time_a < time_b) return (1);
-	if (time_a > time_b) return (-1);
-	return (0);
+static inline int file_compare_atime(const FileInfo *a, const FileInfo *b) {
+	if (a->stat.st_atime < b->stat.st_atime) return (1);
+	if (a->stat.st_atime > b->stat.st_atime) return (-1);
+	return (file_compare_name(a, b));
 }
 
-int compare_file_size(const void *a, const void *b) {
-	if (!a || !b) return (0);
-
-	const FileInfo *file_a = *(const FileInfo **)a;
-	const FileInfo *file_b = *(const FileInfo **)b;
-	
-	if (!file_a || !file_b) return (0);
-	
-	off_t size_a = file_a->stat.st_size;
-	off_t size_b = file_b->stat.st_size;
-		
-	if (size_a < size_b) return (1);
-	if (size_a > size_b) return (-1);
-	return (0);
+static inline int file_compare_size(const FileInfo *a, const FileInfo *b) {
+	if (a->stat.st_size < b->stat.st_size) return (1);
+	if (a->stat.st_size > b->stat.st_size) return (-1);
+	return (file_compare_name(a, b));
 }
 
-int compare_name(const void *a, const void *b) {
-	if (!a || !b) return (0);
-
-	char *t1 = *(char **)a;
-	char *t2 = *(char **)b;
-		
-	if (!t1 || !t2) return (0);
+static inline void swap_files(FileInfo *a, FileInfo *b) {
+	FileInfo tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
 
-	char *s1 = ft_strdup(t1);
-	char *s2 = ft_strdup(t2);
-	
-	if (!s1 || !s2) {
-		if (s1) free(s1);
-		if (s2) free(s2);
-		return (0);
+#define FILE_LESS_ASC(KEY, A, B)  (file_compare_##KEY((A), (B)) < 0)
+#define FILE_LESS_DESC(KEY, A, B) (file_compare_##KEY((B), (A)) < 0)
+
+// Quicksort on the FileInfo values with the key comparison inlined,
+// recursing on the smaller side and finishing small ranges by insertion
+#define DEFINE_FILE_SORT(NAME, KEY, LESS)                                     \
+	static void NAME(FileInfo *items, size_t count) {                         \
+		while (count > INSERTION_SORT_THRESHOLD) {                            \
+			size_t mid = count / 2;                                           \
+			size_t last = count - 1;                                          \
+			if (LESS(KEY, &items[mid], &items[0]))                            \
+				swap_files(&items[mid], &items[0]);                           \
+			if (LESS(KEY, &items[last], &items[0]))                           \
+				swap_files(&items[last], &items[0]);                          \
+			if (LESS(KEY, &items[last], &items[mid]))                         \
+				swap_files(&items[last], &items[mid]);                        \
+			swap_files(&items[mid], &items[last - 1]);                        \
+			FileInfo *pivot = &items[last - 1];                               \
+                                                                              \
+			size_t i = 0;                                                     \
+			size_t j = last - 1;                                              \
+			while (true) {                                                    \
+				while (LESS(KEY, &items[++i], pivot));                        \
+				while (LESS(KEY, pivot, &items[--j]));                        \
+				if (i >= j) break;                                            \
+				swap_files(&items[i], &items[j]);                             \
+			}                                                                 \
+			swap_files(&items[i], &items[last - 1]);                          \
+                                                                              \
+			if (i < count - i - 1) {                                          \
+				NAME(items, i);                                               \
+				items += i + 1;                                               \
+				count -= i + 1;                                               \
+			} else {                                                          \
+				NAME(items + i + 1, count - i - 1);                           \
+				count = i;                                                    \
+			}                                                                 \
+		}                                                                     \
+                                                                              \
+		for (size_t i = 1; i < count; i++) {                                  \
+			FileInfo tmp = items[i];                                          \
+			size_t j = i;                                                     \
+			while (j > 0 && LESS(KEY, &tmp, &items[j - 1])) {                 \
+				items[j] = items[j - 1];                                      \
+				j--;                                                          \
+			}                                                                 \
+			items[j] = tmp;                                                   \
+		}                                                                     \
 	}
 
-	ft_strtolower(s1);
-	ft_strtolower(s2);
-
-	int result = ft_strcmp(s1, s2);
-
-	free(s1);
-	free(s2);
+DEFINE_FILE_SORT(sort_by_name,        name,  FILE_LESS_ASC)
+DEFINE_FILE_SORT(sort_by_name_desc,   name,  FILE_LESS_DESC)
+DEFINE_FILE_SORT(sort_by_mtime,       mtime, FILE_LESS_ASC)
+DEFINE_FILE_SORT(sort_by_mtime_desc,  mtime, FILE_LESS_DESC)
+DEFINE_FILE_SORT(sort_by_atime,       atime, FILE_LESS_ASC)
+DEFINE_FILE_SORT(sort_by_atime_desc,  atime, FILE_LESS_DESC)
+DEFINE_FILE_SORT(sort_by_size,        size,  FILE_LESS_ASC)
+DEFINE_FILE_SORT(sort_by_size_desc,   size,  FILE_LESS_DESC)
+
+void sort_files(FileInfo *items, size_t count, SortType sort_type, bool reverse) {
+	switch (sort_type) {
+		case SORT_NONE:
+			if (reverse) ft_reverse(items, count, sizeof(FileInfo));
+			break;
+		case SORT_MTIME:
+			reverse ? sort_by_mtime_desc(items, count) : sort_by_mtime(items, count);
+			break;
+		case SORT_ATIME:
+			reverse ? sort_by_atime_desc(items, count) : sort_by_atime(items, count);
+			break;
+		case SORT_SIZE:
+			reverse ? sort_by_size_desc(items, count) : sort_by_size(items, count);
+			break;
+		case SORT_NAME:
+		default:
+			reverse ? sort_by_name_desc(items, count) : sort_by_name(items, count);
+			break;
+	}
+}
 
-	return (result);
-}
\ No newline at end of file
+int compare_files(const FileInfo *a, const FileInfo *b, SortType sort_type) {
+	switch (sort_type) {
+		case SORT_NONE:  return (0);
+		case SORT_MTIME: return (file_compare_mtime(a, b));
+		case SORT_ATIME: return (file_compare_atime(a, b));
+		case SORT_SIZE:  return (file_compare_size(a, b));
+		case SORT_NAME:
+		default:         return (file_compare_name(a, b));
+	}
+}
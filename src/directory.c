@@ -1,188 +1,188 @@
 #include "ls.h"
 
-extern Options options;
-extern SortType sort_type;
-extern ShowType show_type;
-
-static void free_file(FileInfo *file) {
-	if (!file) return;
-	free(file->link);
-	free(file->name);
-}
-
-static void free_directory(DirectoryInfo *directory) {
+void free_directory(DirectoryInfo *directory) {
 	if (!directory) return;
 	ft_da_foreach(&directory->files, file, FileInfo) {
-		free_file(file);
+		file_info_free(file, NULL);
 	}
 	
 	ft_da_free(directory->files);
 	free(directory->path);
 }
 
-static bool is_file_hidden(const char *name) {
-	return (name[0] == '.');
-}
-
-static bool is_file_special(const char *name) {
-	return (ft_strcmp(name, ".") == 0 || ft_strcmp(name, "..") == 0);
+static int compare_ranked(const FileInfo *a, const FileInfo *b, SortType sort_type, bool reverse) {
+	int result = compare_files(a, b, sort_type);
+	return (reverse ? -result : result);
 }
 
-static bool should_skip_file(const char *name) {
-	switch (show_type) {
-		case SHOW_ALL:         return (0);
-		case SHOW_ALMOST_ALL:  return (is_file_special(name));
-		case SHOW_VISIBLE:
-		default:               return (is_file_hidden(name));
+// Max-heap on the listing order: the root is the worst entry kept so far
+static void heap_sift_up(FileInfo *items, size_t index, SortType sort_type, bool reverse) {
+	while (index > 0) {
+		size_t parent = (index - 1) / 2;
+		if (compare_ranked(&items[parent], &items[index], sort_type, reverse) >= 0) {
+			break;
+		}
+		FileInfo tmp = items[parent];
+		items[parent] = items[index];
+		items[index] = tmp;
+		index = parent;
 	}
 }
 
-static char *build_path(const char *dir_path, const char *filename) {
-	size_t dir_len = ft_strlen(dir_path);
-	size_t name_len = ft_strlen(filename);
-	size_t total_len = dir_len + name_len + 2; // + 2 for '/' and '\0'
-	
-	char *full_path = malloc(total_len);
-	if (!full_path) {
-		return (NULL);
-	}
-	
-	ft_strcpy(full_path, dir_path);
-	if (dir_path[dir_len - 1] != '/') {
-		ft_strcat(full_path, "/");
-	}
-	ft_strcat(full_path, filename);
-	
-	return (full_path);
-}
+static void heap_sift_down(FileInfo *items, size_t count, size_t index, SortType sort_type, bool reverse) {
+	while (true) {
+		size_t largest = index;
+		size_t left = 2 * index + 1;
+		size_t right = left + 1;
 
-static FileInfo create_file_info(const char *name, const char *full_path, struct stat *st) {
-	FileInfo file = {0};
-	file.name = ft_strdup(name);
-	if (!file.name) {
-		return ((FileInfo){0});
-	}
-	
-	file.link = NULL;
-	file.stat = *st;
-	
-	if (S_ISLNK(st->st_mode)) {
-		char *link_target = malloc(1024);
-		if (link_target) {
-			ssize_t len = readlink(full_path, link_target, 1023);
-			if (len > 0) {
-				link_target[len] = '\0';
-				file.link = link_target;
-			} else {
-				free(link_target);
-			}
+		if (left < count && compare_ranked(&items[left], &items[largest], sort_type, reverse) > 0) {
+			largest = left;
+		}
+		if (right < count && compare_ranked(&items[right], &items[largest], sort_type, reverse) > 0) {
+			largest = right;
 		}
+		if (largest == index) {
+			break;
+		}
+		FileInfo tmp = items[largest];
+		items[largest] = items[index];
+		items[index] = tmp;
+		index = largest;
 	}
-	
-	return (file);
 }
 
-static bool directory_add_file(DirectoryInfo *directory, const char *filename) {
-	char *path = build_path(directory->path, filename);
-	if (!path) {
-		return (false);
-	}
+// Keeps only the config->head best entries, the heap is sorted afterwards
+static bool select_file(FilesInfo *files, FileInfo file, const Config *config) {
+	SortType sort_type = config->sort_type;
+	bool sorted = (sort_type != SORT_NONE);
+	bool reverse = (config->options & REVERSE) != 0;
 
-	struct stat st;
-	if (lstat(path, &st)) {
-		free(path);
+	if (files->count < config->head) {
+		if (!ft_da_append(files, file)) {
+			return (false);
+		}
+		if (sorted) {
+			heap_sift_up(files->items, files->count - 1, sort_type, reverse);
+		}
 		return (true);
 	}
 
-	FileInfo file = create_file_info(filename, path, &st);
-	
-	free(path);
-
-	if (!ft_da_append(&directory->files, file)) {
-		free_file(&file);
-		return (false);
+	if (sorted && compare_ranked(&file, &files->items[0], sort_type, reverse) < 0) {
+		file_info_free(&files->items[0], NULL);
+		files->items[0] = file;
+		heap_sift_down(files->items, files->count, 0, sort_type, reverse);
+	} else {
+		file_info_free(&file, NULL);
 	}
-
 	return (true);
 }
 
-static bool read_directory(char *path, DirectoryInfo *directory) {	
+void print_directory_error(const char *path, int error) {
+	fprintf(stderr, "ft_ls: cannot open directory '%s': %s\n", path, strerror(error));
+}
+
+bool read_directory(const char *path, DirectoryInfo *directory, const Config *config, InodeSet *seen) {
 	directory->path = ft_strdup(path);
 	if (!directory->path) {
 		return (false);
 	}
 
-	DIR *dir = opendir(path);
-	if (!dir) {
-		fprintf(stderr, "ft_ls: cannot open directory '%s': %s\n", path, strerror(errno));
+	// The open error is kept for the caller, which prints it in listing order
+	DirectoryIterator it;
+	if (iterator_open(&it, path, config, NULL) == false) {
+		int error = errno;
 		free_directory(directory);
+		directory->error = error;
 		return (false);
 	}
 
-	struct dirent *entry;
-	while ((entry = readdir(dir)) != NULL) {
-		if (should_skip_file(entry->d_name) == true) {
-			continue;
+	directory->profile = it.profile;
+	if (config->options & IO_DEBUG) {
+		fprintf(stderr, "ft_ls: %s: %s filesystem, %s profile\n", path, it.fs_name, io_profile_name(it.profile));
+	}
+
+	FileInfo file;
+	int status;
+	while ((status = iterator_next(&it, &file)) > 0) {
+		if (seen && !is_file_special(file.name) && !usage_add_file(&directory->usage, &file, seen)) {
+			file_info_free(&file, NULL);
+			status = -1;
+			break;
 		}
 
-		if (directory_add_file(directory, entry->d_name) == false) {
-			fprintf(stderr, "ft_ls: failed to add file to directory\n");
-			free_directory(directory);
-			closedir(dir);
-			return (false);
+		bool added = (config->head > 0)
+			? select_file(&directory->files, file, config)
+			: ft_da_append(&directory->files, file);
+		if (!added) {
+			file_info_free(&file, NULL);
+			status = -1;
+			break;
+		}
+
+		// Unsorted listings keep the first entries, no need to read further
+		if (config->head > 0 && config->sort_type == SORT_NONE && directory->files.count == config->head) {
+			break;
 		}
 	}
 
-	closedir(dir);
+	iterator_close(&it);
+
+	if (status < 0) {
+		fprintf(stderr, "ft_ls: failed to add file to directory\n");
+		free_directory(directory);
+		return (false);
+	}
 	return (true);
 }
 
-static void print_directory(DirectoryInfo *directory) {
-	if (options & RECURSE) {
+void print_directory(DirectoryInfo *directory, const Config *config, bool show_header) {
+	if (show_header) {
 		ft_printf("%s:\n", directory->path);
 	}
 	
-	if ((options & LIST) || (options & LIST_GROUP_ONLY)) {
-		print_list_formatted(directory);
+	if ((config->options & LIST) || (config->options & LIST_GROUP_ONLY)) {
+		print_list_formatted(directory, config);
 	} else {
-		print_formatted(directory);
+		print_formatted(directory, config);
 	}
+}
 
-	if (options & RECURSE) {
-		ft_da_foreach(&directory->files, file, FileInfo) {
-			if (S_ISDIR(file->stat.st_mode) && !is_file_special(file->name)) {
-				char *sub_path = build_path(directory->path, file->name);
-				if (!sub_path) continue;
-				ft_printf("\n");
-				process_directory(sub_path);
-				free(sub_path);
-			}
-		}
+void sort_directory(DirectoryInfo *directory, const Config *config) {
+	FileInfo	*data = directory->files.items;
+	size_t		size = ft_da_size(&directory->files);
+	bool		reverse = (config->options & REVERSE) != 0;
+
+	// Huge directories are sorted in chunks, -r is applied by the merge
+	if (config->sort_type != SORT_NONE && size >= PARALLEL_SORT_THRESHOLD
+		&& parallel_sort_files(data, size, config->sort_type, reverse)) {
+		return;
 	}
+
+	sort_files(data, size, config->sort_type, reverse);
 }
 
-static void sort_directory(DirectoryInfo *directory) {
-	void	*data = directory->files.items;
-	size_t	size = ft_da_size(&directory->files);
-
-	switch (sort_type) {
-		case SORT_NONE: break;
-		case SORT_MTIME: ft_quicksort(data, size, sizeof(FileInfo), compare_file_mtime); break;
-		case SORT_ATIME: ft_quicksort(data, size, sizeof(FileInfo), compare_file_atime); break;
-		case SORT_SIZE: ft_quicksort(data, size, sizeof(FileInfo), compare_file_size); break;
-		case SORT_NAME:
-		default: ft_quicksort(data, size, sizeof(FileInfo), compare_file_name); break;
-	}
+void list_directory(DirectoryInfo *directory, const Config *config, InodeSet *seen, bool show_header) {
+	sort_directory(directory, config);
+	print_directory(directory, config, show_header || (config->options & RECURSE));
 
-	if (options & REVERSE) {
-		ft_reverse(data, size, sizeof(FileInfo));
+	// The pipeline prints the rolled-up totals of the whole subtree
+	if (config->options & RECURSE) {
+		walk_pipeline(directory, config, seen);
+	} else if (seen) {
+		print_usage_summary(directory->path, &directory->usage);
 	}
+	free_directory(directory);
 }
 
-void process_directory(char *path) {
+void process_directory(const char *path, const Config *config) {
+	InodeSet seen = {0};
+	InodeSet *usage_seen = (config->options & DISK_USAGE) ? &seen : NULL;
+
 	DirectoryInfo directory = {0};
-	if (read_directory(path, &directory) == false) return;
-	sort_directory(&directory);
-	print_directory(&directory);
-	free_directory(&directory);
+	if (read_directory(path, &directory, config, usage_seen)) {
+		list_directory(&directory, config, usage_seen, false);
+	} else if (directory.error) {
+		print_directory_error(path, directory.error);
+	}
+	inode_set_free(&seen);
 }
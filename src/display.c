@@ -1,7 +1,5 @@
 #include "ls.h"
 
-extern Options options;
-
 #define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
 
 static inline int number_len(long long n) {
@@ -54,9 +52,17 @@ static const char *get_color_by_mode(mode_t mode) {
 	return RESET;
 }
 
-static void print_colored_name(const FileInfo *file) {
+static const char *get_file_color(const Config *config, const FileInfo *file) {
+	if (!config->colors) {
+		return (get_color_by_mode(file->stat.st_mode));
+	}
+	const char *color = color_lookup(config->colors, file->name, &file->stat, file->orphan);
+	return (color ? color : RESET);
+}
+
+static void print_colored_name(const FileInfo *file, const Config *config) {
 	ft_printf("%s%s%s", 
-		get_color_by_mode(file->stat.st_mode),
+		get_file_color(config, file),
 		file->name,
 		RESET);
 }
@@ -71,7 +77,7 @@ static char get_file_type_char(mode_t mode) {
 	return ('-');
 }
 
-static void print_permissions(FileInfo *file) {
+static void print_permissions(FileInfo *file, bool probe_xattr) {
 	mode_t mode = file->stat.st_mode;
 	
 	ft_printf("%c", get_file_type_char(mode));
@@ -97,15 +103,15 @@ static void print_permissions(FileInfo *file) {
 		((mode & S_ISVTX) ? 't' : 'x') :
 		((mode & S_ISVTX) ? 'T' : '-'));
 
-	if (listxattr(file->name, NULL, 0) > 0) {
+	if (probe_xattr && listxattr(file->name, NULL, 0) > 0) {
 		ft_printf("@");
 	}
 }
 
-static void print_date(const FileInfo *file) {
+static void print_date(const FileInfo *file, const Config *config) {
 	time_t now = time(NULL);
 	time_t file_time = file->stat.st_mtime;
-	if (options & ACCESS_TIME) {
+	if (config->options & ACCESS_TIME) {
 		file_time = file->stat.st_atime;
 	}
 	struct tm *now_tm = localtime(&now);
@@ -131,17 +137,30 @@ static void print_date(const FileInfo *file) {
 	}
 }
 
-static void print_colored_link_target(const char *link_path) {
+// Follows the link itself, so a relative target resolves from the link's directory
+static void print_colored_link_target(const DirectoryInfo *directory, const FileInfo *file, const Config *config) {
 	const char *color = RESET;
 	struct stat st;
-	
-	if (lstat(link_path, &st) == 0) {
-		color = get_color_by_mode(st.st_mode);
+
+	char *link_path = directory->path ? build_path(directory->path, file->name) : file->name;
+	bool found = link_path && stat(link_path, &st) == 0;
+	if (link_path != file->name) {
+		free(link_path);
 	}
-	ft_printf("%s%s%s", color, link_path, RESET);
+
+	if (found) {
+		if (config->colors) {
+			color = color_lookup(config->colors, file->link, &st, false);
+		} else {
+			color = get_color_by_mode(st.st_mode);
+		}
+	} else if (config->colors && config->colors->types[COLOR_MISSING]) {
+		color = config->colors->types[COLOR_MISSING];
+	}
+	ft_printf("%s%s%s", color ? color : RESET, file->link, RESET);
 }
 
-static int create_display_directory(DirectoryInfo *directory, DisplayArray *display_array) {
+static int create_display_directory(DirectoryInfo *directory, DisplayArray *display_array, const Config *config) {
 	display_array->items = NULL;
 	display_array->count = 0;
 	display_array->capacity = 0;
@@ -151,7 +170,13 @@ static int create_display_directory(DirectoryInfo *directory, DisplayArray *disp
 	}
 	
 	for (size_t i = 0; i < directory->files.count; i++) {
-		display_array->items[i].display_name = malloc(256);
+		const char *color = get_file_color(config, &directory->files.items[i]);
+		const char *name = directory->files.items[i].name;
+		size_t color_len = ft_strlen(color);
+		size_t name_len = ft_strlen(name);
+		size_t reset_len = ft_strlen(RESET);
+
+		display_array->items[i].display_name = malloc(color_len + name_len + reset_len + 1);
 		if (!display_array->items[i].display_name) {
 			for (size_t j = 0; j < i; j++) {
 				free(display_array->items[j].display_name);
@@ -161,23 +186,9 @@ static int create_display_directory(DirectoryInfo *directory, DisplayArray *disp
 		}
 		
 		char *buf = display_array->items[i].display_name;
-		int len = 0;
-		const char *color = get_color_by_mode(directory->files.items[i].stat.st_mode);
-		
-		while (*color && len < 255) {
-			buf[len++] = *color++;
-		}
-		
-		const char *name = directory->files.items[i].name;
-		while (*name && len < 255) {
-			buf[len++] = *name++;
-		}
-		
-		const char *reset = RESET;
-		while (*reset && len < 255) {
-			buf[len++] = *reset++;
-		}
-		buf[len] = '\0';
+		ft_memcpy(buf, color, color_len);
+		ft_memcpy(buf + color_len, name, name_len);
+		ft_memcpy(buf + color_len + name_len, RESET, reset_len + 1);
 		
 		display_array->items[i].width = get_display_width(display_array->items[i].display_name);
 	}
@@ -305,13 +316,13 @@ static size_t get_total_blocks(DirectoryInfo *directory) {
 	return (blocks);
 }
 
-void print_formatted(DirectoryInfo *directory) {
+void print_formatted(DirectoryInfo *directory, const Config *config) {
 	if (directory->files.count == 0) {
 		return;
 	}
 	
 	DisplayArray display_array;
-	if (create_display_directory(directory, &display_array) != 0) {
+	if (create_display_directory(directory, &display_array, config) != 0) {
 		fprintf(stderr, "Failed to create display directory\n");
 		return;
 	}
@@ -325,9 +336,13 @@ void print_formatted(DirectoryInfo *directory) {
 	free_display_array(&display_array);
 }
 
-void print_list_formatted(DirectoryInfo *directory) {
-	ft_printf("total %zu\n", get_total_blocks(directory));
+void print_list_formatted(DirectoryInfo *directory, const Config *config) {
+	// File operands are listed without a directory, and without a total
+	if (directory->path) {
+		ft_printf("total %zu\n", get_total_blocks(directory));
+	}
 	ColumnWidths widths = get_list_format(directory);
+	bool probe_xattr = io_profile_probes_xattr(directory->profile);
 	
 	for (size_t i = 0; i < directory->files.count; i++) {
 		FileInfo *file = &directory->files.items[i];
@@ -337,12 +352,12 @@ void print_list_formatted(DirectoryInfo *directory) {
 		const char *username = pwd ? pwd->pw_name : "unknown";
 		const char *groupname = grp ? grp->gr_name : "unknown";
 
-		print_permissions(file);
+		print_permissions(file, probe_xattr);
 		ft_printf(" ");
 		
 		ft_printf("%*zu ", widths.nlink, file->stat.st_nlink);
 		
-		if (!(options & LIST_GROUP_ONLY)) {
+		if (!(config->options & LIST_GROUP_ONLY)) {
 			ft_printf("%*s ", widths.user, username);
 		}
 		
@@ -350,16 +365,21 @@ void print_list_formatted(DirectoryInfo *directory) {
 		
 		ft_printf("%*zu ", widths.size, file->stat.st_size);
 		
-		print_date(file);
+		print_date(file, config);
 		ft_printf(" ");
 		
-		print_colored_name(file);
+		print_colored_name(file, config);
 		
 		if (file->link) {
 			ft_printf(" -> ");
-			print_colored_link_target(file->link);
+			print_colored_link_target(directory, file, config);
 		}
 		
 		ft_printf("\n");
 	}
 }
+
+void print_usage_summary(const char *path, const Usage *usage) {
+	ft_printf("usage %s: %zu blocks, %zu bytes, %zu entries\n",
+		path, usage->blocks, usage->size, usage->entries);
+}
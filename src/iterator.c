@@ -0,0 +1,319 @@
+#include "ls.h"
+
+// Names read and stat-ed per round by batching profiles
+#define BATCH_WINDOW 4096
+
+static void *default_alloc(size_t size, void *context) {
+	(void)context;
+	return (malloc(size));
+}
+
+static void default_free(void *ptr, void *context) {
+	(void)context;
+	free(ptr);
+}
+
+static const Allocator default_allocator = {
+	default_alloc,
+	default_free,
+	NULL,
+};
+
+typedef struct {
+	uint32_t	magic;
+	const char	*name;
+	IoProfile	profile;
+}	FsType;
+
+typedef struct {
+	const char	*name;
+	size_t		stat_threads;  // more than one reads every name before stat
+	bool		probe_xattr;
+}	IoStrategy;
+
+// Values of statfs f_type, as in linux/magic.h
+static const FsType fs_types[] = {
+	{0xEF53,     "ext4",    IO_LOCAL},
+	{0x58465342, "xfs",     IO_LOCAL},
+	{0x9123683E, "btrfs",   IO_LOCAL},
+	{0x794C7630, "overlay", IO_LOCAL},
+	{0x01021994, "tmpfs",   IO_MEMORY},
+	{0x858458F6, "ramfs",   IO_MEMORY},
+	{0x00009FA0, "proc",    IO_MEMORY},
+	{0x62656572, "sysfs",   IO_MEMORY},
+	{0x00006969, "nfs",     IO_NETWORK},
+	{0xFF534D42, "cifs",    IO_NETWORK},
+	{0xFE534D42, "smb2",    IO_NETWORK},
+	{0x65735546, "fuse",    IO_FUSE},
+};
+
+static const IoStrategy io_strategies[] = {
+	[IO_LOCAL]   = {"local",   1,  true},
+	[IO_MEMORY]  = {"memory",  1,  true},
+	[IO_NETWORK] = {"network", 16, true},
+	[IO_FUSE]    = {"fuse",    4,  false},
+};
+
+const char *io_profile_name(IoProfile profile) {
+	return (io_strategies[profile].name);
+}
+
+bool io_profile_probes_xattr(IoProfile profile) {
+	return (io_strategies[profile].probe_xattr);
+}
+
+static void detect_io_profile(DirectoryIterator *it) {
+	it->profile = IO_LOCAL;
+	it->fs_name = "unknown";
+
+	struct statfs fs;
+	if (fstatfs(dirfd(it->dir), &fs) != 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < sizeof(fs_types) / sizeof(fs_types[0]); i++) {
+		if (fs_types[i].magic == (uint32_t)fs.f_type) {
+			it->profile = fs_types[i].profile;
+			it->fs_name = fs_types[i].name;
+			return;
+		}
+	}
+}
+
+bool is_file_hidden(const char *name) {
+	return (name[0] == '.');
+}
+
+bool is_file_special(const char *name) {
+	return (ft_strcmp(name, ".") == 0 || ft_strcmp(name, "..") == 0);
+}
+
+static bool should_skip_file(const char *name, ShowType show_type) {
+	switch (show_type) {
+		case SHOW_ALL:         return (0);
+		case SHOW_ALMOST_ALL:  return (is_file_special(name));
+		case SHOW_VISIBLE:
+		default:               return (is_file_hidden(name));
+	}
+}
+
+char *build_path(const char *dir_path, const char *filename) {
+	size_t dir_len = ft_strlen(dir_path);
+	size_t name_len = ft_strlen(filename);
+	size_t total_len = dir_len + name_len + 2; // + 2 for '/' and '\0'
+
+	char *full_path = malloc(total_len);
+	if (!full_path) {
+		return (NULL);
+	}
+
+	ft_strcpy(full_path, dir_path);
+	if (dir_path[dir_len - 1] != '/') {
+		ft_strcat(full_path, "/");
+	}
+	ft_strcat(full_path, filename);
+
+	return (full_path);
+}
+
+static char *allocator_strndup(const Allocator *allocator, const char *str, size_t len) {
+	char *copy = allocator->alloc(len + 1, allocator->context);
+	if (!copy) {
+		return (NULL);
+	}
+	ft_memcpy(copy, str, len);
+	copy[len] = '\0';
+	return (copy);
+}
+
+void file_info_free(FileInfo *file, const Allocator *allocator) {
+	if (!file) return;
+	if (!allocator) allocator = &default_allocator;
+	if (file->link) allocator->free(file->link, allocator->context);
+	if (file->name) allocator->free(file->name, allocator->context);
+	file->link = NULL;
+	file->name = NULL;
+}
+
+bool iterator_open(DirectoryIterator *it, const char *path, const Config *config, const Allocator *allocator) {
+	*it = (DirectoryIterator){0};
+	it->path = path;
+	it->config = config;
+	it->allocator = allocator ? *allocator : default_allocator;
+	it->dir = opendir(path);
+	if (!it->dir) {
+		return (false);
+	}
+
+	detect_io_profile(it);
+	return (true);
+}
+
+static void batch_clear(DirectoryIterator *it) {
+	for (size_t i = 0; i < it->batch.count; i++) {
+		free(it->batch.items[i].name);
+	}
+	it->batch.count = 0;
+	it->batch_next = 0;
+}
+
+void iterator_close(DirectoryIterator *it) {
+	batch_clear(it);
+	ft_da_free(it->batch);
+	it->batch = (BatchEntries){0};
+
+	if (it->dir) {
+		closedir(it->dir);
+		it->dir = NULL;
+	}
+}
+
+static bool iterator_fill(DirectoryIterator *it, const char *name, struct stat *st, FileInfo *file) {
+	*file = (FileInfo){0};
+	file->stat = *st;
+	file->name = allocator_strndup(&it->allocator, name, ft_strlen(name));
+	if (!file->name) {
+		return (false);
+	}
+
+	if (S_ISLNK(st->st_mode)) {
+		char target[PATH_MAX];
+		ssize_t len = readlinkat(dirfd(it->dir), name, target, sizeof(target) - 1);
+		if (len > 0) {
+			file->link = allocator_strndup(&it->allocator, target, len);
+		}
+
+		// Following the link costs a stat, only pay it when orphans are colored
+		const ColorTable *colors = it->config->colors;
+		if (colors && colors->types[COLOR_ORPHAN]) {
+			struct stat target_st;
+			file->orphan = (fstatat(dirfd(it->dir), name, &target_st, 0) != 0);
+		}
+	}
+
+	return (true);
+}
+
+static void stat_batch_entry(size_t index, void *data) {
+	DirectoryIterator *it = data;
+	BatchEntry *entry = &it->batch.items[index];
+
+	entry->ok = (fstatat(dirfd(it->dir), entry->name, &entry->stat, AT_SYMLINK_NOFOLLOW) == 0);
+}
+
+// High latency filesystems: read a window of names, then keep many stat calls in flight
+static bool load_batch(DirectoryIterator *it) {
+	struct dirent *entry = NULL;
+
+	batch_clear(it);
+	while (it->batch.count < BATCH_WINDOW && (entry = readdir(it->dir)) != NULL) {
+		if (should_skip_file(entry->d_name, it->config->show_type) == true) {
+			continue;
+		}
+
+		BatchEntry batch_entry = {0};
+		batch_entry.name = ft_strdup(entry->d_name);
+		if (!batch_entry.name || !ft_da_append(&it->batch, batch_entry)) {
+			free(batch_entry.name);
+			return (false);
+		}
+	}
+	it->batch_done = (entry == NULL);
+
+	parallel_for(it->batch.count, io_strategies[it->profile].stat_threads, stat_batch_entry, it);
+	return (true);
+}
+
+static int iterator_next_batched(DirectoryIterator *it, FileInfo *file) {
+	while (true) {
+		while (it->batch_next < it->batch.count) {
+			BatchEntry *entry = &it->batch.items[it->batch_next++];
+			if (!entry->ok) {
+				continue;
+			}
+
+			if (iterator_fill(it, entry->name, &entry->stat, file) == false) {
+				file_info_free(file, &it->allocator);
+				return (-1);
+			}
+			return (1);
+		}
+
+		if (it->batch_done) {
+			return (0);
+		}
+		if (load_batch(it) == false) {
+			return (-1);
+		}
+	}
+}
+
+int iterator_next(DirectoryIterator *it, FileInfo *file) {
+	struct dirent *entry;
+
+	if (io_strategies[it->profile].stat_threads > 1) {
+		return (iterator_next_batched(it, file));
+	}
+
+	while ((entry = readdir(it->dir)) != NULL) {
+		if (should_skip_file(entry->d_name, it->config->show_type) == true) {
+			continue;
+		}
+
+		struct stat st;
+		if (fstatat(dirfd(it->dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW)) {
+			continue;
+		}
+
+		if (iterator_fill(it, entry->d_name, &st, file) == false) {
+			file_info_free(file, &it->allocator);
+			return (-1);
+		}
+		return (1);
+	}
+
+	return (0);
+}
+
+typedef struct {
+	const Config		*config;
+	const Allocator		*allocator;
+	WalkCallback		callback;
+	WalkErrorCallback	on_error;
+	void				*data;
+}	Walk;
+
+static bool walk_recursive(const Walk *walk, const char *path, size_t depth) {
+	DirectoryIterator it;
+	if (iterator_open(&it, path, walk->config, walk->allocator) == false) {
+		int error = errno;
+		bool keep_going = walk->on_error ? walk->on_error(path, error, walk->data) : true;
+		errno = error;
+		// Only the root is fatal, subdirectories go through on_error
+		return (depth > 0 && keep_going);
+	}
+
+	bool keep_going = true;
+	FileInfo file;
+	int status = 0;
+	while (keep_going && (status = iterator_next(&it, &file)) > 0) {
+		keep_going = walk->callback(path, &file, walk->data);
+
+		if (keep_going && S_ISDIR(file.stat.st_mode) && !is_file_special(file.name)) {
+			char *sub_path = build_path(path, file.name);
+			if (sub_path) {
+				keep_going = walk_recursive(walk, sub_path, depth + 1);
+				free(sub_path);
+			}
+		}
+		file_info_free(&file, &it.allocator);
+	}
+
+	iterator_close(&it);
+	return (keep_going && status == 0);
+}
+
+bool walk_directory(const char *path, const Config *config, const Allocator *allocator, WalkCallback callback, WalkErrorCallback on_error, void *data) {
+	Walk walk = {config, allocator, callback, on_error, data};
+	return (walk_recursive(&walk, path, 0));
+}
@@ -1,11 +1,8 @@
 #include "ls.h"
 
-Options options = NONE;
-SortType sort_type = SORT_NAME;
-ShowType show_type = SHOW_VISIBLE;
-
 int main(int ac, char **av) {	
-	if (parse_args_options(ac, av) == false) {
+	Config config = {NONE, SORT_NAME, SHOW_VISIBLE, 0, NULL};
+	if (parse_args_options(ac, av, &config) == false) {
 		return (EXIT_FAILURE);
 	}
 	
@@ -13,22 +10,28 @@ int main(int ac, char **av) {
 	if (parse_args_files(ac, av, &files) == false) {
 		return (EXIT_FAILURE);
 	}
+
+	ColorTable colors = {0};
+	const char *ls_colors = getenv("LS_COLORS");
+	if (ls_colors && *ls_colors) {
+		if (color_table_init(&colors, ls_colors) == false) {
+			fprintf(stderr, "ft_ls: failed to parse LS_COLORS\n");
+			ft_da_free(files);
+			return (EXIT_FAILURE);
+		}
+		config.colors = &colors;
+	}
 	
+	bool success;
 	size_t files_count = ft_da_size(&files);
 	if (files_count == 0) {
-		process_directory(".");
+		const char *current[] = {"."};
+		success = process_operands(current, 1, &config);
 	} else {
-		ft_quicksort(&files.items, files_count, sizeof(char *), compare_name);
-		if (options & REVERSE) {
-			ft_reverse(&files.items, files_count, sizeof(char *));
-		}
-
-		for (size_t i = 0; i < files_count; i++) {
-			if (i != 0) ft_printf("\n");
-			process_directory((char *)files.items[i]);
-		}
+		success = process_operands(files.items, files_count, &config);
 	}
 	
+	color_table_free(&colors);
 	ft_da_free(files);
-	return (EXIT_SUCCESS);
+	return (success ? EXIT_SUCCESS : EXIT_FAILURE);
 }
\ No newline at end of file
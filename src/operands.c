@@ -0,0 +1,239 @@
+#include "ls.h"
+
+#include <pthread.h>
+
+#define STAT_THREADS     16
+#define PREFETCH_THREADS 4
+#define PREFETCH_DEPTH   8
+
+typedef struct {
+	const char	*name;
+	struct stat	stat;
+	int			error;  // errno of the failed stat, 0 on success
+}	Operand;
+
+typedef struct {
+	Operand			*operands;
+	const Config	*config;
+}	StatBatch;
+
+typedef struct {
+	const char		*path;
+	DirectoryInfo	directory;
+	InodeSet		seen;
+	bool			ready;
+	bool			ok;
+}	PrefetchSlot;
+
+typedef struct {
+	PrefetchSlot	*slots;
+	size_t			count;
+	size_t			next;      // next slot to be read by a worker
+	size_t			consumed;  // slots already printed and released
+	const Config	*config;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+}	Prefetch;
+
+static void stat_operand(size_t index, void *data) {
+	StatBatch *batch = data;
+	Operand *operand = &batch->operands[index];
+
+	if (lstat(operand->name, &operand->stat) != 0) {
+		operand->error = errno;
+		return;
+	}
+
+	// Like ls, command line links are followed unless listing in long format
+	if (S_ISLNK(operand->stat.st_mode) && !(batch->config->options & (LIST | LIST_GROUP_ONLY))) {
+		struct stat target;
+		if (stat(operand->name, &target) == 0) {
+			operand->stat = target;
+		}
+	}
+}
+
+static bool is_directory_operand(const Operand *operand, const Config *config) {
+	return (S_ISDIR(operand->stat.st_mode) && !(config->options & DIRECTORY));
+}
+
+static bool add_operand(DirectoryInfo *group, const Operand *operand) {
+	FileInfo file = {0};
+	file.stat = operand->stat;
+	file.name = ft_strdup(operand->name);
+	if (!file.name) {
+		return (false);
+	}
+
+	if (S_ISLNK(operand->stat.st_mode)) {
+		char target[PATH_MAX];
+		ssize_t len = readlink(operand->name, target, sizeof(target) - 1);
+		if (len > 0) {
+			target[len] = '\0';
+			file.link = ft_strdup(target);
+		}
+
+		struct stat target_st;
+		file.orphan = (stat(operand->name, &target_st) != 0);
+	}
+
+	if (!ft_da_append(&group->files, file)) {
+		file_info_free(&file, NULL);
+		return (false);
+	}
+	return (true);
+}
+
+static void *prefetch_worker(void *arg) {
+	Prefetch *prefetch = arg;
+
+	pthread_mutex_lock(&prefetch->lock);
+	while (true) {
+		while (prefetch->next < prefetch->count && prefetch->next >= prefetch->consumed + PREFETCH_DEPTH) {
+			pthread_cond_wait(&prefetch->cond, &prefetch->lock);
+		}
+		if (prefetch->next >= prefetch->count) {
+			break;
+		}
+		PrefetchSlot *slot = &prefetch->slots[prefetch->next++];
+		pthread_mutex_unlock(&prefetch->lock);
+
+		InodeSet *seen = (prefetch->config->options & DISK_USAGE) ? &slot->seen : NULL;
+		bool ok = read_directory(slot->path, &slot->directory, prefetch->config, seen);
+
+		pthread_mutex_lock(&prefetch->lock);
+		slot->ok = ok;
+		slot->ready = true;
+		pthread_cond_broadcast(&prefetch->cond);
+	}
+	pthread_mutex_unlock(&prefetch->lock);
+	return (NULL);
+}
+
+static bool print_directories(DirectoryInfo *directories, const Config *config, bool show_header, bool printed) {
+	if (directories->files.count == 0) {
+		return (true);
+	}
+
+	Prefetch prefetch = {0};
+	prefetch.count = directories->files.count;
+	prefetch.config = config;
+	prefetch.slots = calloc(prefetch.count, sizeof(PrefetchSlot));
+	if (!prefetch.slots) {
+		fprintf(stderr, "ft_ls: failed to allocate prefetch slots\n");
+		return (false);
+	}
+	for (size_t i = 0; i < prefetch.count; i++) {
+		prefetch.slots[i].path = directories->files.items[i].name;
+	}
+
+	pthread_mutex_init(&prefetch.lock, NULL);
+	pthread_cond_init(&prefetch.cond, NULL);
+
+	pthread_t threads[PREFETCH_THREADS];
+	size_t started = 0;
+	while (started < PREFETCH_THREADS && started < prefetch.count) {
+		if (pthread_create(&threads[started], NULL, prefetch_worker, &prefetch) != 0) {
+			break;
+		}
+		started++;
+	}
+
+	// Without any worker the directories are read here, one at a time
+	bool success = true;
+	for (size_t i = 0; i < prefetch.count; i++) {
+		PrefetchSlot *slot = &prefetch.slots[i];
+
+		if (started == 0) {
+			InodeSet *seen = (config->options & DISK_USAGE) ? &slot->seen : NULL;
+			slot->ok = read_directory(slot->path, &slot->directory, config, seen);
+		} else {
+			pthread_mutex_lock(&prefetch.lock);
+			while (!slot->ready) {
+				pthread_cond_wait(&prefetch.cond, &prefetch.lock);
+			}
+			pthread_mutex_unlock(&prefetch.lock);
+		}
+
+		if (slot->ok) {
+			if (printed) ft_printf("\n");
+			InodeSet *seen = (config->options & DISK_USAGE) ? &slot->seen : NULL;
+			list_directory(&slot->directory, config, seen, show_header);
+			printed = true;
+		} else {
+			// Workers only record the error, so it shows up in operand order
+			if (slot->directory.error) {
+				print_directory_error(slot->path, slot->directory.error);
+			}
+			success = false;
+		}
+		inode_set_free(&slot->seen);
+
+		pthread_mutex_lock(&prefetch.lock);
+		prefetch.consumed = i + 1;
+		pthread_cond_broadcast(&prefetch.cond);
+		pthread_mutex_unlock(&prefetch.lock);
+	}
+
+	for (size_t i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_cond_destroy(&prefetch.cond);
+	pthread_mutex_destroy(&prefetch.lock);
+	free(prefetch.slots);
+	return (success);
+}
+
+bool process_operands(const char **names, size_t count, const Config *config) {
+	Operand *operands = calloc(count, sizeof(Operand));
+	if (!operands) {
+		fprintf(stderr, "ft_ls: failed to allocate operands\n");
+		return (false);
+	}
+	for (size_t i = 0; i < count; i++) {
+		operands[i].name = names[i];
+	}
+
+	StatBatch batch = {operands, config};
+	parallel_for(count, STAT_THREADS, stat_operand, &batch);
+
+	bool success = true;
+	DirectoryInfo files = {0};
+	DirectoryInfo directories = {0};
+	for (size_t i = 0; i < count && success; i++) {
+		Operand *operand = &operands[i];
+		if (operand->error) {
+			fprintf(stderr, "ft_ls: cannot access '%s': %s\n", operand->name, strerror(operand->error));
+			continue;
+		}
+		DirectoryInfo *group = is_directory_operand(operand, config) ? &directories : &files;
+		if (add_operand(group, operand) == false) {
+			fprintf(stderr, "ft_ls: failed to add name to array\n");
+			success = false;
+		}
+	}
+
+	if (success) {
+		bool printed = false;
+		if (files.files.count > 0) {
+			sort_directory(&files, config);
+			if ((config->options & LIST) || (config->options & LIST_GROUP_ONLY)) {
+				print_list_formatted(&files, config);
+			} else {
+				print_formatted(&files, config);
+			}
+			printed = true;
+		}
+
+		sort_directory(&directories, config);
+		success = print_directories(&directories, config, count > 1, printed);
+	}
+
+	free_directory(&files);
+	free_directory(&directories);
+	for (size_t i = 0; i < count; i++) {
+		if (operands[i].error) success = false;
+	}
+	free(operands);
+	return (success);
+}
@@ -0,0 +1,51 @@
+#include "ls.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct {
+	atomic_size_t	next;
+	size_t			count;
+	ParallelTask	task;
+	void			*data;
+}	ParallelJob;
+
+static void *parallel_worker(void *arg) {
+	ParallelJob *job = arg;
+
+	size_t index;
+	while ((index = atomic_fetch_add(&job->next, 1)) < job->count) {
+		job->task(index, job->data);
+	}
+	return (NULL);
+}
+
+void parallel_for(size_t count, size_t max_threads, ParallelTask task, void *data) {
+	ParallelJob job = {0};
+	atomic_init(&job.next, 0);
+	job.count = count;
+	job.task = task;
+	job.data = data;
+
+	size_t thread_count = (count < max_threads) ? count : max_threads;
+	if (thread_count <= 1) {
+		parallel_worker(&job);
+		return;
+	}
+
+	// The calling thread is one of the workers
+	pthread_t threads[thread_count - 1];
+	size_t started = 0;
+	while (started < thread_count - 1) {
+		if (pthread_create(&threads[started], NULL, parallel_worker, &job) != 0) {
+			break;
+		}
+		started++;
+	}
+
+	parallel_worker(&job);
+
+	for (size_t i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+}
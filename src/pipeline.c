@@ -0,0 +1,228 @@
+#include "ls.h"
+
+#include <pthread.h>
+
+#define PIPELINE_DEPTH 16
+
+typedef struct {
+	DirectoryInfo	directory;
+	char			*failed_path;  // set with directory.error when it could not be read
+	size_t			depth;
+	bool			ok;
+}	PipelineItem;
+
+typedef struct {
+	char	*path;
+	Usage	usage;
+	size_t	depth;
+}	UsageFrame;
+
+typedef struct {
+	UsageFrame	*items;
+	size_t		count;
+	size_t		capacity;
+}	UsageStack;
+
+typedef struct {
+	PipelineItem	items[PIPELINE_DEPTH];
+	size_t			head;
+	size_t			count;
+	bool			done;
+	bool			threaded;  // false when the reader runs on the printing thread
+	const Config	*config;
+	InodeSet		*seen;
+	UsageStack		frames;
+	char			**roots;
+	size_t			root_count;
+	pthread_mutex_t	lock;
+	pthread_cond_t	not_empty;
+	pthread_cond_t	not_full;
+}	Pipeline;
+
+static void free_paths(char **paths, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		free(paths[i]);
+	}
+	free(paths);
+}
+
+static char **collect_subdirectories(DirectoryInfo *directory, size_t *count) {
+	*count = 0;
+	char **paths = malloc(sizeof(char *) * (directory->files.count + 1));
+	if (!paths) {
+		return (NULL);
+	}
+
+	ft_da_foreach(&directory->files, file, FileInfo) {
+		if (S_ISDIR(file->stat.st_mode) && !is_file_special(file->name)) {
+			char *sub_path = build_path(directory->path, file->name);
+			if (!sub_path) continue;
+			paths[(*count)++] = sub_path;
+		}
+	}
+	return (paths);
+}
+
+// Closes every subtree that ends before an entry at the given depth
+static void usage_pop(Pipeline *pipeline, size_t depth) {
+	UsageStack *frames = &pipeline->frames;
+
+	while (frames->count > 0 && frames->items[frames->count - 1].depth >= depth) {
+		UsageFrame *frame = &frames->items[--frames->count];
+		print_usage_summary(frame->path, &frame->usage);
+		if (frames->count > 0) {
+			usage_merge(&frames->items[frames->count - 1].usage, &frame->usage);
+		}
+		free(frame->path);
+	}
+}
+
+static void usage_push(Pipeline *pipeline, DirectoryInfo *directory, size_t depth) {
+	UsageFrame frame = {directory->path, directory->usage, depth};
+	if (ft_da_append(&pipeline->frames, frame)) {
+		directory->path = NULL;
+	}
+}
+
+static void consume_item(Pipeline *pipeline, PipelineItem *item) {
+	if (pipeline->seen) {
+		usage_pop(pipeline, item->depth);
+	}
+
+	ft_printf("\n");
+	if (!item->ok) {
+		if (item->failed_path) {
+			print_directory_error(item->failed_path, item->directory.error);
+			free(item->failed_path);
+		}
+		return;
+	}
+
+	print_directory(&item->directory, pipeline->config, true);
+	if (pipeline->seen) {
+		usage_push(pipeline, &item->directory, item->depth);
+	}
+	free_directory(&item->directory);
+}
+
+static void queue_push(Pipeline *pipeline, PipelineItem *item) {
+	if (!pipeline->threaded) {
+		consume_item(pipeline, item);
+		return;
+	}
+
+	pthread_mutex_lock(&pipeline->lock);
+	while (pipeline->count == PIPELINE_DEPTH) {
+		pthread_cond_wait(&pipeline->not_full, &pipeline->lock);
+	}
+	pipeline->items[(pipeline->head + pipeline->count) % PIPELINE_DEPTH] = *item;
+	pipeline->count++;
+	pthread_cond_signal(&pipeline->not_empty);
+	pthread_mutex_unlock(&pipeline->lock);
+}
+
+static bool queue_pop(Pipeline *pipeline, PipelineItem *item) {
+	pthread_mutex_lock(&pipeline->lock);
+	while (pipeline->count == 0 && !pipeline->done) {
+		pthread_cond_wait(&pipeline->not_empty, &pipeline->lock);
+	}
+	if (pipeline->count == 0) {
+		pthread_mutex_unlock(&pipeline->lock);
+		return (false);
+	}
+	*item = pipeline->items[pipeline->head];
+	pipeline->head = (pipeline->head + 1) % PIPELINE_DEPTH;
+	pipeline->count--;
+	pthread_cond_signal(&pipeline->not_full);
+	pthread_mutex_unlock(&pipeline->lock);
+	return (true);
+}
+
+// Reads in the same depth-first order the directories are printed in
+static void read_subtree(Pipeline *pipeline, char **paths, size_t count, size_t depth) {
+	for (size_t i = 0; i < count; i++) {
+		PipelineItem item = {0};
+		item.depth = depth;
+		item.ok = read_directory(paths[i], &item.directory, pipeline->config, pipeline->seen);
+
+		// Printed by the consumer, the reader can be many directories ahead
+		if (!item.ok && item.directory.error) {
+			item.failed_path = ft_strdup(paths[i]);
+		}
+
+		size_t child_count = 0;
+		char **children = NULL;
+		if (item.ok) {
+			sort_directory(&item.directory, pipeline->config);
+			children = collect_subdirectories(&item.directory, &child_count);
+		}
+
+		queue_push(pipeline, &item);
+
+		if (children) {
+			read_subtree(pipeline, children, child_count, depth + 1);
+			free_paths(children, child_count);
+		}
+	}
+}
+
+static void *pipeline_reader(void *arg) {
+	Pipeline *pipeline = arg;
+
+	read_subtree(pipeline, pipeline->roots, pipeline->root_count, 1);
+
+	pthread_mutex_lock(&pipeline->lock);
+	pipeline->done = true;
+	pthread_cond_signal(&pipeline->not_empty);
+	pthread_mutex_unlock(&pipeline->lock);
+	return (NULL);
+}
+
+void walk_pipeline(DirectoryInfo *root, const Config *config, InodeSet *seen) {
+	Pipeline pipeline = {0};
+	pipeline.config = config;
+	pipeline.seen = seen;
+	pipeline.roots = collect_subdirectories(root, &pipeline.root_count);
+	if (!pipeline.roots) {
+		fprintf(stderr, "ft_ls: failed to collect subdirectories\n");
+		if (seen) {
+			print_usage_summary(root->path, &root->usage);
+		}
+		return;
+	}
+
+	if (seen) {
+		UsageFrame frame = {ft_strdup(root->path), root->usage, 0};
+		if (!frame.path || !ft_da_append(&pipeline.frames, frame)) {
+			free(frame.path);
+		}
+	}
+
+	pthread_mutex_init(&pipeline.lock, NULL);
+	pthread_cond_init(&pipeline.not_empty, NULL);
+	pthread_cond_init(&pipeline.not_full, NULL);
+
+	// Set before the reader starts, it reads the flag on every push
+	pthread_t reader;
+	pipeline.threaded = true;
+	if (pthread_create(&reader, NULL, pipeline_reader, &pipeline) != 0) {
+		pipeline.threaded = false;
+	}
+	if (pipeline.threaded) {
+		PipelineItem item;
+		while (queue_pop(&pipeline, &item)) {
+			consume_item(&pipeline, &item);
+		}
+		pthread_join(reader, NULL);
+	} else {
+		read_subtree(&pipeline, pipeline.roots, pipeline.root_count, 1);
+	}
+
+	usage_pop(&pipeline, 0);
+	ft_da_free(pipeline.frames);
+
+	pthread_cond_destroy(&pipeline.not_full);
+	pthread_cond_destroy(&pipeline.not_empty);
+	pthread_mutex_destroy(&pipeline.lock);
+	free_paths(pipeline.roots, pipeline.root_count);
+}
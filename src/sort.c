@@ -0,0 +1,98 @@
+#include "ls.h"
+
+#define SORT_MAX_THREADS 8
+
+typedef struct {
+	FileInfo	*items;
+	size_t		count;
+	size_t		chunks;
+	SortType	sort_type;
+}	SortJob;
+
+static size_t chunk_start(const SortJob *job, size_t index) {
+	return (job->count * index / job->chunks);
+}
+
+static void sort_chunk(size_t index, void *data) {
+	SortJob *job = data;
+	size_t start = chunk_start(job, index);
+	size_t end = chunk_start(job, index + 1);
+
+	sort_files(job->items + start, end - start, job->sort_type, false);
+}
+
+// Merges the sorted chunks into a list of source indexes, -r picks from the tails
+static void merge_chunks(const SortJob *job, size_t *order, bool reverse) {
+	size_t heads[SORT_MAX_THREADS];
+	size_t ends[SORT_MAX_THREADS];
+
+	for (size_t c = 0; c < job->chunks; c++) {
+		heads[c] = chunk_start(job, c);
+		ends[c] = chunk_start(job, c + 1);
+	}
+
+	for (size_t i = 0; i < job->count; i++) {
+		size_t best = job->chunks;
+		for (size_t c = 0; c < job->chunks; c++) {
+			if (heads[c] == ends[c]) continue;
+
+			size_t candidate = reverse ? ends[c] - 1 : heads[c];
+			if (best == job->chunks) {
+				best = c;
+				continue;
+			}
+
+			size_t current = reverse ? ends[best] - 1 : heads[best];
+			int result = compare_files(&job->items[candidate], &job->items[current], job->sort_type);
+			if (reverse ? result > 0 : result < 0) {
+				best = c;
+			}
+		}
+
+		if (reverse) {
+			order[i] = --ends[best];
+		} else {
+			order[i] = heads[best]++;
+		}
+	}
+}
+
+// Moves every entry to its merged position by following permutation cycles
+static void apply_order(FileInfo *items, size_t *order, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		if (order[i] == i) continue;
+
+		FileInfo tmp = items[i];
+		size_t j = i;
+		while (order[j] != i) {
+			size_t next = order[j];
+			items[j] = items[next];
+			order[j] = j;
+			j = next;
+		}
+		items[j] = tmp;
+		order[j] = j;
+	}
+}
+
+bool parallel_sort_files(FileInfo *items, size_t count, SortType sort_type, bool reverse) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t chunks = (cpus > 1) ? (size_t)cpus : 1;
+	if (chunks > SORT_MAX_THREADS) chunks = SORT_MAX_THREADS;
+	if (chunks < 2) {
+		return (false);
+	}
+
+	size_t *order = malloc(sizeof(size_t) * count);
+	if (!order) {
+		return (false);
+	}
+
+	SortJob job = {items, count, chunks, sort_type};
+	parallel_for(chunks, chunks, sort_chunk, &job);
+	merge_chunks(&job, order, reverse);
+	apply_order(items, order, count);
+
+	free(order);
+	return (true);
+}
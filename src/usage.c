@@ -0,0 +1,79 @@
+#include "ls.h"
+
+static size_t inode_hash(dev_t dev, ino_t ino) {
+	uint64_t hash = (uint64_t)ino * 0x9E3779B97F4A7C15ULL;
+	hash ^= (uint64_t)dev + 0x7F4A7C15ULL + (hash << 6) + (hash >> 2);
+	return ((size_t)(hash ^ (hash >> 29)));
+}
+
+static bool inode_set_grow(InodeSet *set) {
+	size_t capacity = set->capacity ? set->capacity * 2 : 64;
+	InodeKey *items = calloc(capacity, sizeof(InodeKey));
+	if (!items) {
+		return (false);
+	}
+
+	for (size_t i = 0; i < set->capacity; i++) {
+		if (!set->items[i].used) continue;
+		size_t slot = inode_hash(set->items[i].dev, set->items[i].ino) & (capacity - 1);
+		while (items[slot].used) {
+			slot = (slot + 1) & (capacity - 1);
+		}
+		items[slot] = set->items[i];
+	}
+
+	free(set->items);
+	set->items = items;
+	set->capacity = capacity;
+	return (true);
+}
+
+bool inode_set_insert(InodeSet *set, const struct stat *st, bool *inserted) {
+	*inserted = false;
+	if ((set->count + 1) * 2 > set->capacity && !inode_set_grow(set)) {
+		return (false);
+	}
+
+	size_t slot = inode_hash(st->st_dev, st->st_ino) & (set->capacity - 1);
+	while (set->items[slot].used) {
+		if (set->items[slot].dev == st->st_dev && set->items[slot].ino == st->st_ino) {
+			return (true);
+		}
+		slot = (slot + 1) & (set->capacity - 1);
+	}
+
+	set->items[slot] = (InodeKey){st->st_dev, st->st_ino, true};
+	set->count++;
+	*inserted = true;
+	return (true);
+}
+
+void inode_set_free(InodeSet *set) {
+	free(set->items);
+	*set = (InodeSet){0};
+}
+
+bool usage_add_file(Usage *usage, const FileInfo *file, InodeSet *seen) {
+	usage->entries++;
+
+	// Only files with several links can be met twice, skip the lookup otherwise
+	if (file->stat.st_nlink > 1 && !S_ISDIR(file->stat.st_mode)) {
+		bool inserted;
+		if (!inode_set_insert(seen, &file->stat, &inserted)) {
+			return (false);
+		}
+		if (!inserted) {
+			return (true);
+		}
+	}
+
+	usage->blocks += file->stat.st_blocks / 2;
+	usage->size += file->stat.st_size;
+	return (true);
+}
+
+void usage_merge(Usage *parent, const Usage *child) {
+	parent->blocks += child->blocks;
+	parent->size += child->size;
+	parent->entries += child->entries;
+}